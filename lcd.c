@@ -0,0 +1,779 @@
+#include <stddef.h>
+#include <stdarg.h>
+#include "lcd.h"
+
+/* ---------------------------------------------------------
+ * lcd.c
+ * Display state, transport retries and resync, read back
+ * scrubbing and lcd_printf for the LCD2004 on a PFC8574.
+ * Freestanding: no libc calls, the hardware is reached only
+ * through the lcd_ops in struct lcd_state.
+ * -------------------------------------------------------- */
+
+/* DDRAM address of the first cell on each line */
+static const char lcd_row_offset[LCD_ROWS] = { 0x00, 0x40, 0x14, 0x54 };
+
+/* ---------------------------------------------------------
+ * lcd_state_init ( lcd, ops, fd )
+ * lcd:  display state to set up
+ * ops:  transport, e.g. &lcd_i2c_ops
+ * fd:   handed to the ops, the file handle from lcd_init
+ * Only fills in lcd, nothing goes on the bus.  Call it right
+ * after lcd_clear, the panel is all blanks then, or call
+ * lcd_resync to bring up a panel in an unknown state.
+ * -------------------------------------------------------- */
+int lcd_state_init( struct lcd_state *lcd, const struct lcd_ops *ops, int fd )
+{
+    char *p = (char *)lcd;
+    unsigned ix;
+    int r, c;
+    for (ix=0; ix<sizeof(*lcd); ix++) p[ix] = 0;
+    for (r=0; r<LCD_ROWS; r++) {
+        for (c=0; c<LCD_COLS; c++) {
+            lcd->cell[r][c] = ' ';
+        }
+    }
+    lcd_bus_init(&lcd->bus, ops, fd);
+    lcd->display = LCD_DISPLAYCONTROL | LCD_DISPLAYON;
+    lcd->entry = LCD_ENTRYMODESET | LCD_ENTRYLEFT;
+    return 0;
+}
+
+/* ---------------------------------------------------------
+ * lcd_bus_init ( bus, ops, fd )
+ * bus:  the PFC8574 to set up, nothing goes on the i2c bus
+ * ops:  transport, e.g. &lcd_i2c_ops
+ * fd:   handed to the ops
+ * -------------------------------------------------------- */
+int lcd_bus_init( struct lcd_bus *bus, const struct lcd_ops *ops, int fd )
+{
+    char *p = (char *)&bus->stats;
+    unsigned ix;
+    for (ix=0; ix<sizeof(bus->stats); ix++) p[ix] = 0;
+    bus->ops = ops;
+    bus->fd = fd;
+    return 0;
+}
+
+static void lcd_delay(struct lcd_bus *bus, long ns)
+{
+    bus->ops->delay(ns);
+}
+
+/* ---------------------------------------------------------
+ * one byte to the PFC8574, retried with backoff.  Sending
+ * the same port value again is harmless, so a retry can't
+ * latch a nibble twice.
+ * -------------------------------------------------------- */
+static int lcd_xfer(struct lcd_bus *bus, char data)
+{
+    long wait = LCD_RETRY_NS;
+    int ix;
+    for (ix=0; ; ix++) {
+        bus->stats.writes++;
+        if (bus->ops->write(bus->fd, data) == 0) return 0;
+        if (ix == LCD_RETRIES) break;
+        bus->stats.retries++;
+        lcd_delay(bus, wait);
+        wait *= 2;
+    }
+    bus->stats.errors++;
+    return -1;
+}
+
+/* ---------------------------------------------------------
+ * the lcd latches the nibble when En goes low.  -1 the
+ * nibble never reached it, -2 En went up and may be stuck
+ * there, so the next write can latch a stray nibble.
+ * -------------------------------------------------------- */
+static int lcd_send_nibble(struct lcd_bus *bus, char buf)
+{
+    if (lcd_xfer(bus, buf | LCD_BACKLIGHT) < 0) return -1;
+    if (lcd_xfer(bus, buf | LCD_EN | LCD_BACKLIGHT) < 0) return -1;
+    if (lcd_xfer(bus, (buf & ~LCD_EN) | LCD_BACKLIGHT) < 0) return -2;
+    return 0;
+}
+
+/* ---------------------------------------------------------
+ * lcd_bus_nibble ( bus, buf )
+ * strobe one nibble, buf is the port value without En and
+ * backlight: data in the top 4 bits, LCD_RS if it's data.
+ * return value: 0 ok, -1 failed
+ * -------------------------------------------------------- */
+int lcd_bus_nibble( struct lcd_bus *bus, char buf )
+{
+    int rc = lcd_send_nibble(bus, buf);
+    if (rc == -2) bus->stats.desyncs++;
+    return (rc < 0) ? -1 : 0;
+}
+
+/* ---------------------------------------------------------
+ * lcd_bus_write ( bus, val, mode )
+ * send a byte as two nibbles and wait for the lcd to take
+ * it.  A failure after any En edge leaves the lcd half a
+ * byte out of step and everything after it would be
+ * garbage, that counts as a desync.
+ * mode: 0 for a command, LCD_RS for data
+ * return value: 0 ok, -1 failed
+ * -------------------------------------------------------- */
+int lcd_bus_write( struct lcd_bus *bus, char val, char mode )
+{
+    int rc = lcd_send_nibble(bus, mode | (val & 0xf0));
+    if (rc == 0 && lcd_send_nibble(bus, mode | ((val << 4) & 0xf0)) < 0) rc = -2;
+    if (rc < 0) {
+        if (rc == -2) bus->stats.desyncs++;
+        return -1;
+    }
+    /* clear and home take 1.52ms, the rest 37us */
+    if (mode == 0 && (unsigned char)val < 0x04) lcd_delay(bus, 1600000L);
+    else lcd_delay(bus, 40000L);
+    return 0;
+}
+
+/* read side of lcd_xfer, re-reading the port is harmless too */
+static int lcd_recv(struct lcd_bus *bus, char *in)
+{
+    long wait = LCD_RETRY_NS;
+    int ix;
+    for (ix=0; ; ix++) {
+        bus->stats.reads++;
+        if (bus->ops->read(bus->fd, in) == 0) return 0;
+        if (ix == LCD_RETRIES) break;
+        bus->stats.retries++;
+        lcd_delay(bus, wait);
+        wait *= 2;
+    }
+    bus->stats.errors++;
+    return -1;
+}
+
+/* ---------------------------------------------------------
+ * read one nibble.  The data pins are set high so the lcd
+ * can pull them down, the nibble is on P4-P7 while En is
+ * up.  -1/-2 as for lcd_send_nibble.
+ * -------------------------------------------------------- */
+static int lcd_recv_nibble(struct lcd_bus *bus, char mode, char *nib)
+{
+    char data = 0xf0 | LCD_RW | mode | LCD_BACKLIGHT;
+    char in;
+    if (lcd_xfer(bus, data) < 0) return -1;
+    if (lcd_xfer(bus, data | LCD_EN) < 0) return -1;
+    if (lcd_recv(bus, &in) < 0) return -2;
+    if (lcd_xfer(bus, data) < 0) return -2;
+    *nib = in & 0xf0;
+    return 0;
+}
+
+/* ---------------------------------------------------------
+ * lcd_bus_read ( bus, buf, cnt )
+ * read cnt bytes of DDRAM or CGRAM from the current
+ * address, set it first with LCD_SETDDRAMADDR or
+ * LCD_SETCGRAMADDR.  Each read moves the address on by
+ * one, and a read right after a write isn't valid.
+ * return value: bytes read, -1 failed
+ * -------------------------------------------------------- */
+int lcd_bus_read( struct lcd_bus *bus, char *buf, int cnt )
+{
+    char hi, lo;
+    int ix, rc;
+    for (ix=0; ix<cnt; ix++) {
+        rc = lcd_recv_nibble(bus, LCD_RS, &hi);
+        if (rc == 0 && lcd_recv_nibble(bus, LCD_RS, &lo) < 0) rc = -2;
+        if (rc < 0) {
+            if (rc == -2) bus->stats.desyncs++;
+            return -1;
+        }
+        buf[ix] = hi | ((lo >> 4) & 0x0f);
+    }
+    return cnt;
+}
+
+/* ---------------------------------------------------------
+ * lcd_bus_start ( bus, display, entry )
+ * Put the lcd in 4 bit, 2 line, 5x8 mode no matter which
+ * nibble it was waiting for (or from power on), send the
+ * display control and entry mode commands and clear it.
+ * Waits are the datasheet minimums plus a little, about
+ * 7ms in all, most of it the first 4.1ms and the clear.
+ * return value: 0 ok, -1 failed
+ * -------------------------------------------------------- */
+int lcd_bus_start( struct lcd_bus *bus, char display, char entry )
+{
+    /* 8 bit function set three times, then switch to 4 bit */
+    if (lcd_send_nibble(bus, 0x30) < 0) return -1;
+    lcd_delay(bus, 4500000L);
+    if (lcd_send_nibble(bus, 0x30) < 0) return -1;
+    lcd_delay(bus, 150000L);
+    if (lcd_send_nibble(bus, 0x30) < 0) return -1;
+    lcd_delay(bus, 150000L);
+    if (lcd_send_nibble(bus, 0x20) < 0) return -1;
+    lcd_delay(bus, 150000L);
+
+    if (lcd_bus_write(bus, LCD_FUNCTIONSET | LCD_2LINE | LCD_5x8DOTS | LCD_4BITMODE, 0) < 0) return -1;
+    if (lcd_bus_write(bus, display, 0) < 0) return -1;
+    if (lcd_bus_write(bus, entry, 0) < 0) return -1;
+    return lcd_bus_write(bus, LCD_CLEARDISPLAY, 0);
+}
+
+/* ---------------------------------------------------------
+ * lcd_resync ( lcd )
+ * Put the lcd back in 4 bit mode no matter which nibble it
+ * was waiting for, then restore the display control and
+ * entry mode and repaint the custom chars and the cells
+ * from lcd_state.
+ * return value: 0 ok, -1 the bus is still down, the next
+ * lcd_send will try again
+ * -------------------------------------------------------- */
+int lcd_resync( struct lcd_state *lcd )
+{
+    int ix, r, c, ac;
+
+    lcd->desync = 1;
+    if (lcd_bus_start(&lcd->bus, lcd->display, lcd->entry) < 0) return -1;
+
+    if (lcd->nglyphs > 0) {
+        if (lcd_bus_write(&lcd->bus, LCD_SETCGRAMADDR, 0) < 0) return -1;
+        for (ix=0; ix<lcd->nglyphs*8; ix++) {
+            if (lcd_bus_write(&lcd->bus, lcd->glyph[ix/8][ix%8], LCD_RS) < 0) return -1;
+        }
+    }
+
+    /* after the clear only the non blank cells need sending */
+    ac = -1;
+    for (r=0; r<LCD_ROWS; r++) {
+        for (c=0; c<LCD_COLS; c++) {
+            if (lcd->cell[r][c] == ' ') continue;
+            if (ac != lcd_row_offset[r] + c) {
+                ac = lcd_row_offset[r] + c;
+                if (lcd_bus_write(&lcd->bus, LCD_SETDDRAMADDR | ac, 0) < 0) return -1;
+            }
+            if (lcd_bus_write(&lcd->bus, lcd->cell[r][c], LCD_RS) < 0) return -1;
+            ac++;
+        }
+    }
+
+    lcd->desync = 0;
+    lcd->bus.stats.resyncs++;
+    return 0;
+}
+
+/* ---------------------------------------------------------
+ * lcd_send ( lcd, val, mode )
+ * lcd_write_char that survives a noisy bus: each i2c write
+ * is retried, and if a byte still can't be sent the lcd is
+ * resynced and repainted from lcd_state.
+ * mode: 0 for a command, LCD_RS for data
+ * Display control and entry mode commands are kept in
+ * lcd_state, so a resync puts them back.
+ * return value: 0 sent, 1 the byte was NOT sent, the lcd
+ * was resynced instead and its address counter is unknown
+ * (a kept command is in effect anyway), -1 the bus is down
+ * -------------------------------------------------------- */
+int lcd_send( struct lcd_state *lcd, char val, char mode )
+{
+    if (mode == 0 && (val & 0xf8) == LCD_DISPLAYCONTROL) lcd->display = val;
+    if (mode == 0 && (val & 0xfc) == LCD_ENTRYMODESET) lcd->entry = val;
+
+    if (lcd->desync) {
+        return (lcd_resync(lcd) < 0) ? -1 : 1;
+    }
+    if (lcd_bus_write(&lcd->bus, val, mode) == 0) return 0;
+    return (lcd_resync(lcd) < 0) ? -1 : 1;
+}
+
+/* ---------------------------------------------------------
+ * lcd_load_glyphs ( lcd, nchars, font )
+ * load up to 8 custom chars into CGRAM and keep a copy so
+ * a resync can put them back.  Chars 0-7 in lcd_printf
+ * with %c show them.
+ * -------------------------------------------------------- */
+int lcd_load_glyphs( struct lcd_state *lcd, int nchars, char font[][8] )
+{
+    int ix, rc;
+    if (nchars < 0 || nchars > LCD_GLYPHS) return -1;
+    for (ix=0; ix<nchars*8; ix++) lcd->glyph[ix/8][ix%8] = font[ix/8][ix%8];
+    lcd->nglyphs = nchars;
+
+    rc = lcd_send(lcd, LCD_SETCGRAMADDR, 0);
+    if (rc != 0) return rc;
+    for (ix=0; ix<nchars*8; ix++) {
+        rc = lcd_send(lcd, font[ix/8][ix%8], LCD_RS);
+        if (rc != 0) return rc;
+    }
+    return 0;
+}
+
+/* ---------------------------------------------------------
+ * lcd_get_stats ( lcd, stats )
+ * copy out the transport error counters
+ * -------------------------------------------------------- */
+int lcd_get_stats( struct lcd_state *lcd, struct lcd_stats *stats )
+{
+    *stats = lcd->bus.stats;
+    return 0;
+}
+
+/* ---------------------------------------------------------
+ * lcd_scrub ( lcd, ncells )
+ * lcd:    display state
+ * ncells: how many cells to check this call
+ * Reads back the next few DDRAM cells, then the CGRAM rows
+ * of the loaded custom chars, and rewrites the ones that
+ * don't match lcd_state.  Call it every tick with a small
+ * ncells and the whole panel gets checked every few ticks
+ * without repainting it.
+ * return value: cells rewritten, -1 if the bus is down
+ * -------------------------------------------------------- */
+int lcd_scrub( struct lcd_state *lcd, int ncells )
+{
+    int total, pos, addr, ac, fixed;
+    char want, got, cmd, mask;
+
+    if (lcd->desync) {
+        return (lcd_resync(lcd) < 0) ? -1 : 0;
+    }
+
+    total = LCD_ROWS * LCD_COLS + lcd->nglyphs * 8;
+    ac = -1;
+    fixed = 0;
+    for (; ncells > 0; ncells--) {
+        if (lcd->scrub >= total) lcd->scrub = 0;
+        pos = lcd->scrub++;
+
+        if (pos < LCD_ROWS * LCD_COLS) {
+            want = lcd->cell[pos / LCD_COLS][pos % LCD_COLS];
+            addr = lcd_row_offset[pos / LCD_COLS] + pos % LCD_COLS;
+            cmd = LCD_SETDDRAMADDR;
+            mask = 0xff;
+        } else {
+            pos -= LCD_ROWS * LCD_COLS;
+            want = lcd->glyph[pos / 8][pos % 8];
+            addr = 0x100 + pos;    /* keep CGRAM apart from DDRAM in ac */
+            cmd = LCD_SETCGRAMADDR;
+            mask = 0x1f;           /* CGRAM rows are 5 dots wide */
+        }
+
+        /* reading moves the address on by one, like a write */
+        if (addr != ac && lcd_bus_write(&lcd->bus, cmd | (addr & 0x7f), 0) < 0) break;
+        if (lcd_bus_read(&lcd->bus, &got, 1) < 0) break;
+        ac = addr + 1;
+        lcd->bus.stats.scrubbed++;
+        if (((got ^ want) & mask) == 0) continue;
+
+        /* a read straight after a write isn't valid, so the
+           next cell sets its address again */
+        if (lcd_bus_write(&lcd->bus, cmd | (addr & 0x7f), 0) < 0) break;
+        if (lcd_bus_write(&lcd->bus, want, LCD_RS) < 0) break;
+        ac = -1;
+        lcd->bus.stats.repaired++;
+        fixed++;
+    }
+    if (ncells == 0) return fixed;
+    return (lcd_resync(lcd) < 0) ? -1 : fixed;
+}
+
+//# printf flags
+#define FMT_LEFT   0x01
+#define FMT_ZERO   0x02
+#define FMT_PLUS   0x04
+#define FMT_SPACE  0x08
+
+/* ---------------------------------------------------------
+ * lcd_sink: where lcd_vprintf puts its characters.
+ * x,y is the cursor inside the region, ac is where we
+ * think the LCD address counter is (-1 = don't know).
+ * down is set once a resync has failed, the rest of the
+ * call only updates lcd_state so it doesn't sit through
+ * the retry backoff again for every cell.
+ * -------------------------------------------------------- */
+struct lcd_sink {
+    struct lcd_state *lcd;
+    int row, col;
+    int width, height;
+    int x, y;
+    int ac;
+    int down;
+    int changed;
+};
+
+/* ---------------------------------------------------------
+ * put one char in the next cell of the region, send it
+ * only if the panel doesn't already show it.  Anything
+ * past the bottom of the region is dropped.
+ * -------------------------------------------------------- */
+static void lcd_sink_char(struct lcd_sink *s, char ch)
+{
+    int r, c, addr, rc;
+    if (s->x == s->width) {
+        s->x = 0;
+        s->y++;
+    }
+    if (s->y >= s->height) return;
+    r = s->row + s->y;
+    c = s->col + s->x++;
+    if (s->lcd->cell[r][c] == ch) return;
+
+    /* update the state first, a resync repaints from it */
+    s->lcd->cell[r][c] = ch;
+    s->changed++;
+    if (s->down) return;
+
+    addr = lcd_row_offset[r] + c;
+    if (addr != s->ac) {
+        rc = lcd_send(s->lcd, LCD_SETDDRAMADDR | addr, 0);
+        if (rc != 0) {
+            s->ac = -1;
+            s->down = (rc < 0);
+            return;
+        }
+    }
+    rc = lcd_send(s->lcd, ch, LCD_RS);
+    s->ac = (rc == 0) ? addr + 1 : -1;
+    s->down = (rc < 0);
+}
+
+static void lcd_sink_newline(struct lcd_sink *s)
+{
+    /* region already full, a clipped char doesn't move x */
+    if (s->y >= s->height) return;
+    while (s->x < s->width) lcd_sink_char(s, ' ');
+    s->x = 0;
+    s->y++;
+}
+
+static void lcd_fmt_pad(struct lcd_sink *s, char ch, int n)
+{
+    while (n-- > 0) lcd_sink_char(s, ch);
+}
+
+static void lcd_fmt_string(struct lcd_sink *s, const char *str, int flags,
+                           int width, int prec)
+{
+    int i, len = 0;
+    while (str[len] && (prec < 0 || len < prec)) len++;
+    if (!(flags & FMT_LEFT)) lcd_fmt_pad(s, ' ', width - len);
+    for (i=0; i<len; i++) {
+        if (str[i] == '\n') lcd_sink_newline(s);
+        else lcd_sink_char(s, str[i]);
+    }
+    if (flags & FMT_LEFT) lcd_fmt_pad(s, ' ', width - len);
+}
+
+/* count the digits of val, *div gets the top digit's place value */
+static int lcd_fmt_ndigits(unsigned long long val, int base,
+                           unsigned long long *div)
+{
+    int n = 1;
+    *div = 1;
+    while (val / *div >= (unsigned)base) {
+        *div *= base;
+        n++;
+    }
+    return n;
+}
+
+static void lcd_fmt_digits(struct lcd_sink *s, unsigned long long val,
+                           unsigned long long div, int base, int ndig,
+                           int upper)
+{
+    const char *digits = upper ? "0123456789ABCDEF" : "0123456789abcdef";
+    for (; ndig > 0; ndig--) {
+        lcd_sink_char(s, digits[val / div]);
+        val %= div;
+        div /= base;
+    }
+}
+
+static char lcd_fmt_sign(int neg, int flags)
+{
+    if (neg) return '-';
+    if (flags & FMT_PLUS) return '+';
+    if (flags & FMT_SPACE) return ' ';
+    return 0;
+}
+
+static void lcd_fmt_number(struct lcd_sink *s, unsigned long long val,
+                           int neg, int base, int upper, int flags,
+                           int width, int prec)
+{
+    unsigned long long div;
+    int ndig, zeros, len;
+    char sign = lcd_fmt_sign(neg, flags);
+
+    ndig = lcd_fmt_ndigits(val, base, &div);
+    if (prec == 0 && val == 0) ndig = 0;
+    zeros = (prec > ndig) ? prec - ndig : 0;
+    len = ndig + zeros + (sign != 0);
+    if ((flags & FMT_ZERO) && !(flags & FMT_LEFT) && prec < 0) {
+        zeros += (width > len) ? width - len : 0;
+        len = width;
+    }
+
+    if (!(flags & FMT_LEFT)) lcd_fmt_pad(s, ' ', width - len);
+    if (sign) lcd_sink_char(s, sign);
+    lcd_fmt_pad(s, '0', zeros);
+    lcd_fmt_digits(s, val, div, base, ndig, upper);
+    if (flags & FMT_LEFT) lcd_fmt_pad(s, ' ', width - len);
+}
+
+/* ---------------------------------------------------------
+ * a*b - p exactly, where p is a*b rounded (Dekker).  The
+ * volatile keeps the splits from being fused into an fma.
+ * -------------------------------------------------------- */
+static double lcd_fmt_prod_err(double a, double b, double p)
+{
+    volatile double c;
+    double ah, al, bh, bl;
+    c = 134217729.0 * a;
+    ah = c - (c - a);
+    al = a - ah;
+    c = 134217729.0 * b;
+    bh = c - (c - b);
+    bl = b - bh;
+    return ((ah * bh - p) + ah * bl + al * bh) + al * bl;
+}
+
+/* ---------------------------------------------------------
+ * %f without a scratch buffer: integer part and fraction
+ * are sent as two numbers, precision is capped at 9.  An
+ * exact half rounds to even like glibc.
+ * -------------------------------------------------------- */
+static void lcd_fmt_float(struct lcd_sink *s, double val, int flags,
+                          int width, int prec)
+{
+    unsigned long long ipart, fpart, scale = 1, div;
+    double frac, rest, err;
+    int i, neg = 0, ndig, zeros = 0, len, odd;
+    char sign;
+
+    if (val != val) {
+        lcd_fmt_string(s, "nan", flags & FMT_LEFT, width, -1);
+        return;
+    }
+    /* 1/val catches -0.0, which compares equal to 0 */
+    if (val < 0 || (val == 0 && 1 / val < 0)) {
+        neg = 1;
+        val = -val;
+    }
+    if (val >= 1.8e19) {
+        lcd_fmt_string(s, neg ? "-inf" : "inf", flags & FMT_LEFT, width, -1);
+        return;
+    }
+    if (prec < 0) prec = 6;
+    if (prec > 9) prec = 9;
+    for (i=0; i<prec; i++) scale *= 10;
+
+    /* both subtractions are exact, only the multiply rounds */
+    ipart = (unsigned long long)val;
+    val -= (double)ipart;
+    frac = val * (double)scale;
+    fpart = (unsigned long long)frac;
+    rest = frac - (double)fpart;
+    if (rest == 0.5) {
+        /* looks like a half, the multiply's error says which way */
+        err = lcd_fmt_prod_err(val, (double)scale, frac);
+        odd = (prec ? fpart : ipart) & 1;
+        if (err > 0 || (err == 0 && odd)) fpart++;
+    } else if (rest > 0.5) {
+        fpart++;
+    }
+    if (fpart >= scale) {
+        ipart++;
+        fpart -= scale;
+    }
+
+    sign = lcd_fmt_sign(neg, flags);
+    ndig = lcd_fmt_ndigits(ipart, 10, &div);
+    len = (sign != 0) + ndig + (prec ? prec + 1 : 0);
+    if ((flags & FMT_ZERO) && !(flags & FMT_LEFT) && width > len) {
+        zeros = width - len;
+        len = width;
+    }
+
+    if (!(flags & FMT_LEFT)) lcd_fmt_pad(s, ' ', width - len);
+    if (sign) lcd_sink_char(s, sign);
+    lcd_fmt_pad(s, '0', zeros);
+    lcd_fmt_digits(s, ipart, div, 10, ndig, 0);
+    if (prec) {
+        lcd_sink_char(s, '.');
+        lcd_fmt_digits(s, fpart, scale / 10, 10, prec, 0);
+    }
+    if (flags & FMT_LEFT) lcd_fmt_pad(s, ' ', width - len);
+}
+
+/* ---------------------------------------------------------
+ * lcd_vprintf ( lcd, line, pos, width, height, fmt, ap )
+ * lcd:    display state from lcd_state_init
+ * line:   top line of the region, 1 to 4
+ * pos:    left column of the region, 0 to 19
+ * width:  columns in the region, 0 = to end of line
+ * height: lines in the region, 0 = 1
+ * fmt:    printf format, supports %d %i %u %x %X %o %c %s %f
+ *         %% with - 0 + space flags, width, precision, * and
+ *         h hh l ll z length modifiers.  Unlike printf, %f
+ *         stops at 9 decimals and prints inf for anything
+ *         from 1.8e19 up, no # flag, %e, %g, %p or %n.
+ * Text fills the region left to right and wraps at its right
+ * edge, \n starts the next line of the region.  The unused
+ * cells are blanked, anything that doesn't fit is dropped.
+ * return value: number of cells that changed, -1 if the
+ * region is off the display.  The state is updated even
+ * when the bus is down so the next resync shows it.
+ * -------------------------------------------------------- */
+int lcd_vprintf( struct lcd_state *lcd, int line, int pos, int width,
+                 int height, const char *fmt, va_list ap )
+{
+    struct lcd_sink s;
+    int flags, fwidth, prec, lng, base;
+    long long sval;
+    unsigned long long uval;
+    const char *str;
+
+    if (line < 1 || line > LCD_ROWS || pos < 0 || pos >= LCD_COLS) return -1;
+    if (width <= 0 || width > LCD_COLS - pos) width = LCD_COLS - pos;
+    if (height <= 0) height = 1;
+    if (height > LCD_ROWS - line + 1) height = LCD_ROWS - line + 1;
+
+    s.lcd = lcd;
+    s.row = line - 1;
+    s.col = pos;
+    s.width = width;
+    s.height = height;
+    s.x = 0;
+    s.y = 0;
+    s.ac = -1;
+    s.down = 0;
+    s.changed = 0;
+
+    /* a pending resync can't wait for a cell to change, the
+       panel may be showing garbage since the last fault */
+    if (lcd->desync && lcd_resync(lcd) < 0) s.down = 1;
+
+    for (; *fmt; fmt++) {
+        if (*fmt != '%') {
+            if (*fmt == '\n') lcd_sink_newline(&s);
+            else lcd_sink_char(&s, *fmt);
+            continue;
+        }
+
+        flags = 0;
+        for (;;) {
+            fmt++;
+            if (*fmt == '-') flags |= FMT_LEFT;
+            else if (*fmt == '0') flags |= FMT_ZERO;
+            else if (*fmt == '+') flags |= FMT_PLUS;
+            else if (*fmt == ' ') flags |= FMT_SPACE;
+            else break;
+        }
+
+        fwidth = 0;
+        if (*fmt == '*') {
+            fwidth = va_arg(ap, int);
+            if (fwidth < 0) {
+                flags |= FMT_LEFT;
+                fwidth = -fwidth;
+            }
+            fmt++;
+        } else {
+            while (*fmt >= '0' && *fmt <= '9') fwidth = fwidth*10 + (*fmt++ - '0');
+        }
+
+        prec = -1;
+        if (*fmt == '.') {
+            fmt++;
+            prec = 0;
+            if (*fmt == '*') {
+                prec = va_arg(ap, int);
+                fmt++;
+            } else {
+                while (*fmt >= '0' && *fmt <= '9') prec = prec*10 + (*fmt++ - '0');
+            }
+        }
+
+        lng = 0;
+        while (*fmt == 'h') {
+            lng--;
+            fmt++;
+        }
+        while (*fmt == 'l') {
+            lng++;
+            fmt++;
+        }
+        if (*fmt == 'z') {
+            lng = 3;
+            fmt++;
+        }
+
+        switch (*fmt) {
+          case 'd':
+          case 'i':
+             if (lng == 3) sval = (long long)va_arg(ap, size_t);
+             else if (lng == 2) sval = va_arg(ap, long long);
+             else if (lng == 1) sval = va_arg(ap, long);
+             else sval = va_arg(ap, int);
+             if (lng == -1) sval = (short)sval;
+             else if (lng <= -2) sval = (signed char)sval;
+             if (sval < 0) uval = -(unsigned long long)sval;
+             else uval = sval;
+             lcd_fmt_number(&s, uval, sval < 0, 10, 0, flags, fwidth, prec);
+             break;
+          case 'u':
+          case 'x':
+          case 'X':
+          case 'o':
+             if (lng == 3) uval = va_arg(ap, size_t);
+             else if (lng == 2) uval = va_arg(ap, unsigned long long);
+             else if (lng == 1) uval = va_arg(ap, unsigned long);
+             else uval = va_arg(ap, unsigned int);
+             if (lng == -1) uval = (unsigned short)uval;
+             else if (lng <= -2) uval = (unsigned char)uval;
+             base = (*fmt == 'u') ? 10 : (*fmt == 'o') ? 8 : 16;
+             lcd_fmt_number(&s, uval, 0, base, *fmt == 'X',
+                            flags & ~(FMT_PLUS | FMT_SPACE), fwidth, prec);
+             break;
+          case 'f':
+          case 'F':
+             lcd_fmt_float(&s, va_arg(ap, double), flags, fwidth, prec);
+             break;
+          case 'c':
+             if (!(flags & FMT_LEFT)) lcd_fmt_pad(&s, ' ', fwidth - 1);
+             lcd_sink_char(&s, (char)va_arg(ap, int));
+             if (flags & FMT_LEFT) lcd_fmt_pad(&s, ' ', fwidth - 1);
+             break;
+          case 's':
+             str = va_arg(ap, const char *);
+             lcd_fmt_string(&s, str ? str : "(null)", flags, fwidth, prec);
+             break;
+          case '%':
+             lcd_sink_char(&s, '%');
+             break;
+          case '\0':
+             fmt--;
+             break;
+          default:
+             lcd_sink_char(&s, '%');
+             lcd_sink_char(&s, *fmt);
+             break;
+        }
+    }
+
+    /* blank whatever is left of the region */
+    while (s.y < s.height) lcd_sink_newline(&s);
+    return s.changed;
+}
+
+/* ---------------------------------------------------------
+ * lcd_printf ( lcd, line, pos, width, height, fmt, ... )
+ * see lcd_vprintf.  e.g. a 6 wide field at line 2 col 14:
+ *    lcd_printf(&lcd, 2, 14, 6, 1, "%5.1fC", temp);
+ * -------------------------------------------------------- */
+int lcd_printf( struct lcd_state *lcd, int line, int pos, int width,
+                int height, const char *fmt, ... )
+{
+    va_list ap;
+    int n;
+    va_start(ap, fmt);
+    n = lcd_vprintf(lcd, line, pos, width, height, fmt, ap);
+    va_end(ap);
+    return n;
+}
@@ -0,0 +1,158 @@
+#ifndef LCD_H
+#define LCD_H
+
+#include <stdarg.h>
+
+/* ---------------------------------------------------------
+ * lcd.h
+ * Core of the LCD2004 20x4 driver for a PFC8574 backpack.
+ * lcd.c does no stdio, no malloc and never exits, all it
+ * needs is a struct lcd_state from the caller and a set of
+ * lcd_ops to reach the hardware.
+ * -------------------------------------------------------- */
+
+//# commands
+#define LCD_CLEARDISPLAY  0x01
+#define LCD_RETURNHOME  0x02
+#define LCD_ENTRYMODESET  0x04
+#define LCD_DISPLAYCONTROL  0x08
+#define LCD_CURSORSHIFT  0x10
+#define LCD_FUNCTIONSET  0x20
+#define LCD_SETCGRAMADDR  0x40
+#define LCD_SETDDRAMADDR  0x80
+
+//# flags for display entry mode
+#define LCD_ENTRYRIGHT  0x00
+#define LCD_ENTRYLEFT  0x02
+#define LCD_ENTRYSHIFTINCREMENT  0x01
+#define LCD_ENTRYSHIFTDECREMENT  0x00
+
+//# flags for display on/off control
+#define LCD_DISPLAYON  0x04
+#define LCD_DISPLAYOFF  0x00
+#define LCD_CURSORON  0x02
+#define LCD_CURSOROFF  0x00
+#define LCD_BLINKON  0x01
+#define LCD_BLINKOFF  0x00
+
+//# flags for display/cursor shift
+#define LCD_DISPLAYMOVE  0x08
+#define LCD_CURSORMOVE  0x00
+#define LCD_MOVERIGHT  0x04
+#define LCD_MOVELEFT  0x00
+
+//# flags for function set
+#define LCD_8BITMODE  0x10
+#define LCD_4BITMODE  0x00
+#define LCD_2LINE  0x08
+#define LCD_1LINE  0x00
+#define LCD_5x10DOTS  0x04
+#define LCD_5x8DOTS  0x00
+
+//# flags for backlight control
+#define LCD_BACKLIGHT  0x08
+#define LCD_NOBACKLIGHT  0x00
+
+// enable bit
+#define LCD_EN 0b00000100 
+// read/write bit
+#define LCD_RW 0b00000010 
+// register select
+#define LCD_RS 0b00000001 
+
+//# display geometry, 20x4
+#define LCD_ROWS  4
+#define LCD_COLS  20
+#define LCD_GLYPHS  8
+
+//# transport retries, each retry waits twice as long
+#define LCD_RETRIES  5
+#define LCD_RETRY_NS  50000L
+
+/* ---------------------------------------------------------
+ * lcd_stats: transport error counters, see lcd_get_stats
+ * writes:  i2c writes attempted, retries included
+ * reads:   i2c reads attempted, retries included
+ * retries: transfers that failed and were tried again
+ * errors:  transfers that still failed after all the retries
+ * desyncs: bytes cut off after an En edge, the lcd may
+ *          have latched a stray nibble
+ * resyncs: times the lcd was put back in 4 bit mode and
+ *          repainted
+ * scrubbed: cells read back by lcd_scrub
+ * repaired: cells lcd_scrub found wrong and rewrote
+ * -------------------------------------------------------- */
+struct lcd_stats {
+    unsigned long writes;
+    unsigned long reads;
+    unsigned long retries;
+    unsigned long errors;
+    unsigned long desyncs;
+    unsigned long resyncs;
+    unsigned long scrubbed;
+    unsigned long repaired;
+};
+
+/* ---------------------------------------------------------
+ * lcd_ops: how the core talks to the PFC8574.  fd is passed
+ * through untouched, it doesn't have to be a file handle.
+ * write: put one byte on the port, 0 ok, -1 failed
+ * read:  read the port back, 0 ok, -1 failed
+ * delay: wait at least ns nanoseconds (under 1 second)
+ * lcd_i2c.h has the ops for linux i2c-dev.
+ * -------------------------------------------------------- */
+struct lcd_ops {
+    int  (*write)( int fd, char data );
+    int  (*read)( int fd, char *data );
+    void (*delay)( long ns );
+};
+
+/* ---------------------------------------------------------
+ * lcd_bus: one PFC8574 and its error counters.  The fd
+ * calls in lcd_i2c.c make one on the stack per call,
+ * struct lcd_state has its own.
+ * -------------------------------------------------------- */
+struct lcd_bus {
+    const struct lcd_ops *ops;
+    int  fd;
+    struct lcd_stats stats;
+};
+
+/* ---------------------------------------------------------
+ * lcd_state: what we believe the panel is showing.
+ * lcd_printf compares against this and only sends the
+ * cells that actually change.  After a transport error the
+ * lcd is resynced and repainted from here.  The caller owns
+ * it, the library keeps nothing of its own.  display and
+ * entry are the last display control and entry mode
+ * commands sent with lcd_send.
+ * -------------------------------------------------------- */
+struct lcd_state {
+    struct lcd_bus bus;
+    char cell[LCD_ROWS][LCD_COLS];
+    char glyph[LCD_GLYPHS][8];
+    int  nglyphs;
+    char display;
+    char entry;
+    int  desync;
+    int  scrub;
+};
+
+/* ---------------------------------------------------------
+ * lcd.c
+ * -------------------------------------------------------- */
+int lcd_bus_init( struct lcd_bus *, const struct lcd_ops *, int );
+int lcd_bus_nibble( struct lcd_bus *, char );
+int lcd_bus_write( struct lcd_bus *, char, char );
+int lcd_bus_read( struct lcd_bus *, char *, int );
+int lcd_bus_start( struct lcd_bus *, char, char );
+int lcd_state_init( struct lcd_state *, const struct lcd_ops *, int );
+int lcd_send( struct lcd_state *, char, char );
+int lcd_resync( struct lcd_state * );
+int lcd_load_glyphs( struct lcd_state *, int, char [][8] );
+int lcd_get_stats( struct lcd_state *, struct lcd_stats * );
+int lcd_scrub( struct lcd_state *, int );
+int lcd_printf( struct lcd_state *, int, int, int, int, const char *, ... );
+int lcd_vprintf( struct lcd_state *, int, int, int, int, const char *, va_list );
+
+#endif
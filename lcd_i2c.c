@@ -0,0 +1,212 @@
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/ioctl.h>
+#include "linux/i2c-dev.h"
+#include "lcd_i2c.h"
+
+/* ---------------------------------------------------------
+ * lcd_i2c.c
+ * Linux i2c-dev side of the driver: the lcd_ops that lcd.c
+ * uses, and the original calls that take the file handle.
+ * Those are thin wrappers, the nibble protocol, retries and
+ * timing all live in lcd.c.  No stdio, errors come back
+ * as -1.
+ * -------------------------------------------------------- */
+
+static int lcd_i2c_write(int fd, char data)
+{
+    return (write(fd, &data, 1) == 1) ? 0 : -1;
+}
+
+static int lcd_i2c_read(int fd, char *data)
+{
+    return (read(fd, data, 1) == 1) ? 0 : -1;
+}
+
+static void lcd_i2c_delay(long ns)
+{
+    struct timespec ts;
+    ts.tv_sec = 0;
+    ts.tv_nsec = ns;
+    nanosleep(&ts, NULL);
+}
+
+const struct lcd_ops lcd_i2c_ops = {
+    lcd_i2c_write,
+    lcd_i2c_read,
+    lcd_i2c_delay,
+};
+
+/* --------------------------------------------------------------
+ * lcd_init( int deviceID )
+ * arguments: deviceID    the device ID of your PFC8574
+ * use i2cdetect -y 1 to see whats there. the A0, A1, and A2
+ * pins on your PFC will determine the ID.
+ * return value: fd    file handle to the special i2c device,
+ * -1 if it can't be opened or the lcd doesn't answer
+ * (errno says why)
+ * ------------------------------------------------------------- */
+int lcd_init( char deviceID )
+{
+    int fd;
+    struct lcd_bus bus;
+    fd = open("/dev/i2c-1", O_RDWR);
+    if(fd < 0) {
+        return -1;
+    }
+    if(ioctl(fd, I2C_SLAVE, deviceID) < 0) {
+        close(fd);
+        return -1;
+    }
+
+    lcd_bus_init(&bus, &lcd_i2c_ops, fd);
+    if (lcd_bus_start(&bus, LCD_DISPLAYCONTROL | LCD_DISPLAYON,
+                      LCD_ENTRYMODESET | LCD_ENTRYLEFT) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+
+/* ---------------------------------------------------------
+ * -------------------------------------------------------- */
+int lcd_clear( int fd )
+{
+    if (lcd_write_char(fd, LCD_CLEARDISPLAY, 0) < 0) return(-1);
+    return lcd_write_char(fd, LCD_RETURNHOME, 0);
+}
+
+
+/* ---------------------------------------------------------
+ * -------------------------------------------------------- */
+int lcd_write( int fd, char buf ) 
+{
+    if (lcd_i2c_write(fd, buf) < 0) {
+        return(-1);
+    }
+    return(1);
+}
+
+/* ---------------------------------------------------------
+ * -------------------------------------------------------- */
+int lcd_write_char(int fd, char charval, char mode)
+{
+    struct lcd_bus bus;
+    lcd_bus_init(&bus, &lcd_i2c_ops, fd);
+    if (lcd_bus_write(&bus, charval, mode) < 0) return(-1);
+    return(1);
+}
+
+/* ---------------------------------------------------------
+ * -------------------------------------------------------- */
+int lcd_write_four_bits(int fd, char buf) 
+{
+    struct lcd_bus bus;
+    lcd_bus_init(&bus, &lcd_i2c_ops, fd);
+    if (lcd_bus_nibble(&bus, buf) < 0) return(-1);
+    return(1);
+}
+
+/* ---------------------------------------------------------
+ * lcd_backlight:
+ * turn on/off backlight
+ * -------------------------------------------------------- */
+int lcd_backlight( int fd, int istate)
+{
+	if (istate == 0){
+            if (lcd_write(fd, LCD_NOBACKLIGHT) < 0) return -1;
+	} else {
+            if (lcd_write(fd, LCD_BACKLIGHT) < 0) return -1;
+	}
+        return 0;
+}
+
+/* ---------------------------------------------------------
+ * lcd_write_string ( fd, str, line )
+ * fd:   file handle
+ * str:  char string
+ * line: what line to print on
+ * return value: 0 ok, -1 on an i2c error
+ * -------------------------------------------------------- */
+int lcd_write_string( int fd, char *str, int line)
+{
+     int ix, len;
+     char lch[]={ 0x80, 0xC0, 0x94, 0xD4 };
+     int ich;
+     switch (line) {
+       case 2:
+	  ich=1;
+          break;
+       case 3:
+	  ich=2;
+          break;
+       case 4:
+	  ich=3;
+          break;
+       default:
+	  ich=0;
+          break;
+     }
+     if (lcd_write_char(fd, lch[ich], 0) < 0) return -1;
+
+     len = strlen(str);
+     for (ix=0; ix<len; ix++) {
+	if ((ix > 0) && ((ix % 20) == 0)) {
+              ich++;
+	      if (ich > 3) ich=0;
+              if (lcd_write_char(fd, lch[ich], 0) < 0) return -1;
+	}
+        if (lcd_write_char(fd, str[ix], LCD_RS) < 0) return -1;
+     }
+     return 0;
+}
+
+/* ---------------------------------------------------------
+ * lcd_read_byte_data ( fd, buf, cnt )
+ * fd:   file handle
+ * buf:  where the bytes go
+ * cnt:  how many to read
+ * Reads DDRAM or CGRAM from the current address, set it
+ * first with LCD_SETDDRAMADDR or LCD_SETCGRAMADDR.
+ * return value: bytes read, -1 on an i2c error
+ * -------------------------------------------------------- */
+int lcd_read_byte_data(int fd, char *buf, int cnt)
+{
+    struct lcd_bus bus;
+    lcd_bus_init(&bus, &lcd_i2c_ops, fd);
+    return lcd_bus_read(&bus, buf, cnt);
+}
+
+int lcd_load_custom_chars(int fd, int nchars, char fontdata[][8]) 
+{
+    int irow, icol;
+    char ch;
+    if (lcd_write_char(fd, LCD_SETCGRAMADDR, 0) < 0) return -1;
+    for (irow=0; irow<nchars; irow++) {
+    	for (icol=0; icol<8; icol++) {
+		ch = fontdata[irow][icol];
+    		if (lcd_write_char(fd, ch,  LCD_RS) < 0) return -1;
+	}
+    }
+    return 1;
+
+}
+
+int lcd_display_string_pos(int fd, char *str, int line, int pos)
+{
+   char pos_new;
+   int i,len;
+   len = strlen(str);
+   if (line == 1) pos_new = (char)pos;
+   else if (line == 2) pos_new = 0x40 + (char)pos;
+   else if (line == 3) pos_new = 0x14 + (char)pos;
+   else if (line == 4) pos_new = 0x54 + (char)pos;
+   if (lcd_write_char(fd, 0x80 + pos_new, 0) < 0) return -1;
+   for (i=0; i<len; i++) {
+       if (lcd_write_char(fd, str[i], 1) < 0) return -1;
+   }
+   return 1;
+}
@@ -0,0 +1,32 @@
+#ifndef LCD_I2C_H
+#define LCD_I2C_H
+
+#include "lcd.h"
+
+/* ---------------------------------------------------------
+ * lcd_i2c.h
+ * LCD2004 on a PFC8574 through linux i2c-dev, /dev/i2c-1.
+ * Pass lcd_i2c_ops and the fd from lcd_init to
+ * lcd_state_init to use the lcd.h calls.
+ * -------------------------------------------------------- */
+
+//# LCD Address
+#define LCD_I2C_ADDRESS  0x27
+
+extern const struct lcd_ops lcd_i2c_ops;
+
+/* ---------------------------------------------------------
+ * lcd_i2c.c
+ * -------------------------------------------------------- */
+int lcd_init( char );
+int lcd_clear( int );
+int lcd_write_four_bits(int, char);
+int lcd_write_char(int, char, char);
+int lcd_write( int, char );
+int lcd_backlight( int, int );
+int lcd_write_string( int, char *, int );
+int lcd_read_byte_data( int, char *, int);
+int lcd_load_custom_chars( int, int, char [][8]);
+int lcd_display_string_pos(int, char *, int, int);
+
+#endif
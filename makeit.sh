@@ -2,6 +2,13 @@
 
 ## Compile the code with GCC on Raspberry PI
 
-gcc -g i2cdemo-pim.c -o i2cdemo-pim.x
+## lcd.c is the freestanding core, lcd_i2c.c the linux i2c-dev side
+gcc -Os -ffreestanding -fPIC -c lcd.c -o lcd.o
+gcc -Os -fPIC -c lcd_i2c.c -o lcd_i2c.o
 
+## static and shared library
+ar rcs liblcd.a lcd.o lcd_i2c.o
+gcc -shared -o liblcd.so lcd.o lcd_i2c.o
+
+gcc -g i2cdemo-pim.c liblcd.a -o i2cdemo-pim.x
 